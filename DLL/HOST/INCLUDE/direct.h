@@ -0,0 +1,13 @@
+/* ----------------------------------------------------------------------------
+ * HOST - DOS <direct.h> for the DLL sources on Linux.
+ * ---------------------------------------------------------------------------- */
+
+#ifndef __DIRECT_H_
+#define __DIRECT_H_
+
+#include <sys/stat.h>
+#include <unistd.h>
+
+#define mkdir(path) mkdir(path, 0777)
+
+#endif
@@ -0,0 +1,69 @@
+﻿using DIV2.Format.Exporter.CLI.Interfaces;
+using System;
+using System.Collections.Generic;
+using System.IO;
+
+namespace DIV2.Format.Exporter.CLI.Commands
+{
+    class PAKCommand : ICommand
+    {
+        #region Methods & Functions
+        public void PrintHelp()
+        {
+            Console.WriteLine("Packs the graphs of several FPG files in a PAK archive and writes their stub FPG files, for PAK.DLL.");
+            Console.WriteLine("Usage: pak -o <PAK filename> -s <stub output directory> [-c] <FPG files...>");
+            Console.WriteLine("  -o   Output PAK filename.");
+            Console.WriteLine("  -s   Output directory of the stub FPG files. Must not be the directory of the FPG files.");
+            Console.WriteLine("  -c   Writes compact 1x1 stub graphs (DIV clips, culls and restores them as 1x1 sprites).");
+        }
+
+        public int Run(params string[] args)
+        {
+            string output = null;
+            string stubPath = null;
+            bool compact = false;
+            var files = new List<string>();
+
+            for (int i = 0; i < args.Length; i++)
+            {
+                switch (args[i].ToLower())
+                {
+                    case "-o": output = i + 1 < args.Length ? args[++i] : null; break;
+                    case "-s": stubPath = i + 1 < args.Length ? args[++i] : null; break;
+                    case "-c": compact = true; break;
+                    default: files.Add(args[i]); break;
+                }
+            }
+
+            if (output == null || stubPath == null || files.Count == 0)
+            {
+                this.PrintHelp();
+                return 1;
+            }
+
+            try
+            {
+                var pak = new PAK();
+
+                foreach (string file in files)
+                {
+                    pak.AddFPG(file);
+                }
+
+                Directory.CreateDirectory(stubPath);
+                pak.SaveStubs(stubPath, compact);
+                pak.Save(output);
+
+                Console.WriteLine($"\"{output}\" created with {pak.Count} graphs, stubs written to \"{stubPath}\".");
+            }
+            catch (Exception e)
+            {
+                Console.WriteLine(e.Message);
+                return 1;
+            }
+
+            return 0;
+        }
+        #endregion
+    }
+}
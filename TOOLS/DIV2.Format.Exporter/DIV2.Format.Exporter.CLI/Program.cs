@@ -1,14 +1,22 @@
 ﻿using System;
+using System.Linq;
 using DIV2.Format.Exporter.CLI.Commands;
 
 namespace DIV2.Format.Exporter.CLI
 {
     class Program
     {
-        static void Main(string[] args)
+        static int Main(string[] args)
         {
+            if (args.Length > 0 && args[0].ToLower() == "pak")
+            {
+                return new PAKCommand().Run(args.Skip(1).ToArray());
+            }
+
             new VersionCommand().Run();
             Console.ReadKey();
+
+            return 0;
         }
     }
 }
@@ -0,0 +1,327 @@
+﻿using DIV2.Format.Exporter.MethodExtensions;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+
+namespace DIV2.Format.Exporter
+{
+    /// <summary>
+    /// PAK creator. Packs the graphs of several <see cref="FPG"/> files in a single archive with a graph index and LZ compressed graphs.
+    /// </summary>
+    /// <remarks>The archive is read by PAK.DLL. The game loads the stub <see cref="FPG"/> files written by <see cref="SaveStubs(string, bool)"/>
+    /// instead of the original ones, and each graph is read from the archive the first time that is drawn.</remarks>
+    public class PAK : DIVFormatCommonBase
+    {
+        #region Constants
+        const int FPG_HEADER_LENGTH = DIVFormatCommonBase.BASE_HEADER_LENGTH + PAL.COLOR_TABLE_LENGTH + PAL.RANGE_TABLE_LENGHT;
+        const int ENTRY_LENGTH = 40;
+        const string STUB_PREFIX = "PAK ";
+
+        // LZSS setup, must match DLL\LZ.H:
+        const int LZ_WINDOW = 4096;
+        const int LZ_MIN_MATCH = 3;
+        const int LZ_MAX_MATCH = 15 + LZ_MIN_MATCH;
+        const int LZ_MAX_CHAIN = 256;   // Max candidates checked for each match.
+        #endregion
+
+        #region Structures
+        struct Entry
+        {
+            #region Public vars
+            public int graphId;
+            public byte[] filename;
+            public int width;
+            public int height;
+            public int controlPoints;
+            public byte[] points;
+            public byte[] packedData;
+            public int rawLength;
+            #endregion
+        }
+
+        struct Source
+        {
+            #region Public vars
+            public string filename;
+            public string path;
+            public byte[] header;
+            public List<int> entries;
+            #endregion
+        }
+        #endregion
+
+        #region Internal vars
+        List<Entry> _entries;
+        List<Source> _sources;
+        #endregion
+
+        #region Properties
+        /// <summary>
+        /// Number of graphs packed.
+        /// </summary>
+        public int Count => this._entries.Count;
+        #endregion
+
+        #region Constructor
+        /// <summary>
+        /// Create new empty <see cref="PAK"/> instance.
+        /// </summary>
+        public PAK() : base("pak")
+        {
+            this._entries = new List<Entry>();
+            this._sources = new List<Source>();
+        }
+        #endregion
+
+        #region Methods & Functions
+        static byte[] Compress(byte[] data)
+        {
+            var output = new List<byte>(data.Length / 2);
+            var head = new Dictionary<int, int>();
+            var previous = new int[data.Length];
+            int pos = 0;
+
+            while (pos < data.Length)
+            {
+                int flagIndex = output.Count;
+                byte flags = 0;
+
+                output.Add(0);
+
+                for (int bit = 0; bit < 8 && pos < data.Length; bit++)
+                {
+                    PAK.FindMatch(data, pos, head, previous, out int distance, out int length);
+
+                    if (length >= PAK.LZ_MIN_MATCH)
+                    {
+                        output.Add((byte)((distance - 1) & 0xFF));
+                        output.Add((byte)((((distance - 1) >> 4) & 0xF0) | (length - PAK.LZ_MIN_MATCH)));
+
+                        for (int i = 1; i < length; i++)
+                        {
+                            PAK.InsertHash(data, pos + i, head, previous);
+                        }
+
+                        pos += length;
+                    }
+                    else
+                    {
+                        flags |= (byte)(1 << bit);
+                        output.Add(data[pos++]);
+                    }
+                }
+
+                output[flagIndex] = flags;
+            }
+
+            return output.ToArray();
+        }
+
+        static int InsertHash(byte[] data, int pos, Dictionary<int, int> head, int[] previous)
+        {
+            if (pos + PAK.LZ_MIN_MATCH > data.Length)
+            {
+                return -1;
+            }
+
+            int hash = (data[pos] << 16) | (data[pos + 1] << 8) | data[pos + 2];
+
+            previous[pos] = head.TryGetValue(hash, out int last) ? last : -1;
+            head[hash] = pos;
+
+            return previous[pos];
+        }
+
+        static void FindMatch(byte[] data, int pos, Dictionary<int, int> head, int[] previous, out int distance, out int length)
+        {
+            int max = Math.Min(PAK.LZ_MAX_MATCH, data.Length - pos);
+            int candidate = PAK.InsertHash(data, pos, head, previous);
+
+            distance = 0;
+            length = 0;
+
+            for (int chain = 0; candidate >= 0 && pos - candidate <= PAK.LZ_WINDOW && chain < PAK.LZ_MAX_CHAIN; chain++)
+            {
+                int len = 0;
+                while (len < max && data[candidate + len] == data[pos + len])
+                {
+                    len++;
+                }
+
+                if (len > length)
+                {
+                    length = len;
+                    distance = pos - candidate;
+
+                    if (length == max)
+                    {
+                        break;
+                    }
+                }
+
+                candidate = previous[candidate];
+            }
+        }
+
+        static byte[] GetNullPaddedString(string text, int length)
+        {
+            var buffer = new byte[length];
+            byte[] ascii = text.ToByteArray();
+
+            Array.Copy(ascii, buffer, Math.Min(ascii.Length, length));
+
+            return buffer;
+        }
+
+        /// <summary>
+        /// Adds all graphs of a <see cref="FPG"/> file to the archive.
+        /// </summary>
+        /// <param name="filename"><see cref="FPG"/> filename.</param>
+        public void AddFPG(string filename)
+        {
+            byte[] buffer = File.ReadAllBytes(filename);
+
+            if (!new FPG().Validate(buffer))
+            {
+                throw new FormatException($"Invalid FPG file \"{filename}\".");
+            }
+
+            var source = new Source()
+            {
+                filename = Path.GetFileName(filename).ToUpper(),
+                path = Path.GetFullPath(filename),
+                header = new byte[PAK.FPG_HEADER_LENGTH],
+                entries = new List<int>()
+            };
+
+            Array.Copy(buffer, source.header, PAK.FPG_HEADER_LENGTH);
+
+            using (var file = new BinaryReader(new MemoryStream(buffer)))
+            {
+                file.BaseStream.Position = PAK.FPG_HEADER_LENGTH;
+
+                while (file.BaseStream.Position + FPG.MAP_BASE_METADATA_LENGTH <= file.BaseStream.Length)
+                {
+                    int graphId = file.ReadInt32();
+                    int length = file.ReadInt32();
+                    file.ReadBytes(FPG.DESCRIPTION_LENGTH);
+                    byte[] mapFilename = file.ReadBytes(FPG.FILENAME_LENGTH);
+                    int width = file.ReadInt32();
+                    int height = file.ReadInt32();
+                    int controlPoints = file.ReadInt32();
+
+                    byte[] data = file.ReadBytes(length - FPG.MAP_BASE_METADATA_LENGTH);
+
+                    source.entries.Add(this._entries.Count);
+                    this._entries.Add(new Entry()
+                    {
+                        graphId = graphId,
+                        filename = mapFilename,
+                        width = width,
+                        height = height,
+                        controlPoints = controlPoints,
+                        points = data.Take(controlPoints * FPG.CONTROLPOINT_LENGTH).ToArray(),
+                        packedData = PAK.Compress(data),
+                        rawLength = data.Length
+                    });
+                }
+            }
+
+            this._sources.Add(source);
+        }
+
+        /// <summary>
+        /// Writes the stub <see cref="FPG"/> files, one for each <see cref="FPG"/> added, to load in the game instead of the original files.
+        /// </summary>
+        /// <param name="outputPath">Directory to write the stub files. Must not be the directory of any source <see cref="FPG"/>, the stubs has the same filenames.</param>
+        /// <param name="compact">Writes 1x1 stub graphs instead of graphs of the real size.</param>
+        /// <remarks>Each stub graph has the same graphic id, described as "PAK &lt;entry index&gt;". By default, the stub graphs keep the real
+        /// width, height and control points with transparent pixels, so DIV bounding boxes, off-screen culling and screen restore works as with
+        /// the original graphs, but load_fpg() still allocates their pixels.
+        /// Compact stubs are 1x1 graphs that not use this memory. DIV only knows the stub size, so their sprites are clipped, culled and restored
+        /// as 1x1 sprites: large graphs can disappear at the screen edges or leave trails. Use compact stubs only with restore_type = complete_restore
+        /// and graphs that not cross the screen edges.</remarks>
+        public void SaveStubs(string outputPath, bool compact = false)
+        {
+            foreach (var source in this._sources)
+            {
+                if (string.Equals(Path.GetFullPath(Path.Combine(outputPath, source.filename)), source.path, StringComparison.OrdinalIgnoreCase))
+                {
+                    throw new ArgumentException($"The stub of \"{source.path}\" overwrites the source FPG file. Use other output directory.", nameof(outputPath));
+                }
+            }
+
+            foreach (var source in this._sources)
+            {
+                using (var file = new BinaryWriter(File.Create(Path.Combine(outputPath, source.filename))))
+                {
+                    file.Write(source.header);
+
+                    foreach (int index in source.entries)
+                    {
+                        Entry entry = this._entries[index];
+                        int width = compact ? 1 : entry.width;
+                        int height = compact ? 1 : entry.height;
+                        byte[] points = compact ? new byte[0] : entry.points;
+
+                        file.Write(entry.graphId);
+                        file.Write(FPG.MAP_BASE_METADATA_LENGTH + points.Length + (width * height));
+                        file.Write($"{PAK.STUB_PREFIX}{index}".GetASCIIZString(FPG.DESCRIPTION_LENGTH));
+                        file.Write(entry.filename);
+                        file.Write(width);
+                        file.Write(height);
+                        file.Write(points.Length / FPG.CONTROLPOINT_LENGTH);
+                        file.Write(points);
+                        file.Write(new byte[width * height]);
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// Writes the index and the compressed graphs to file.
+        /// </summary>
+        /// <param name="file"><see cref="BinaryWriter"/> instance.</param>
+        internal override void Write(BinaryWriter file)
+        {
+            if (this._entries.Count == 0)
+            {
+                throw new InvalidOperationException("The PAK not contain any FPG to pack.");
+            }
+
+            base.Write(file);
+            file.Write(this._entries.Count);
+
+            int offset = DIVFormatCommonBase.BASE_HEADER_LENGTH + sizeof(int) + (PAK.ENTRY_LENGTH * this._entries.Count);
+
+            foreach (var source in this._sources)
+            {
+                foreach (int index in source.entries)
+                {
+                    Entry entry = this._entries[index];
+
+                    file.Write(PAK.GetNullPaddedString(source.filename, FPG.FILENAME_LENGTH));
+                    file.Write(entry.graphId);
+                    file.Write(entry.width);
+                    file.Write(entry.height);
+                    file.Write(entry.controlPoints);
+                    file.Write(offset);
+                    file.Write(entry.packedData.Length);
+                    file.Write(entry.rawLength);
+
+                    offset += entry.packedData.Length;
+                }
+            }
+
+            foreach (var source in this._sources)
+            {
+                foreach (int index in source.entries)
+                {
+                    file.Write(this._entries[index].packedData);
+                }
+            }
+        }
+        #endregion
+    }
+}